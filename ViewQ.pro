@@ -21,6 +21,13 @@ SOURCES += \
     main.cpp
 
 HEADERS += \
+    bundle.h \
+    imageformat.h \
+    panepool.h \
+    prefetch.h \
+    presentation.h \
+    soak.h \
+    timing.h
 
 FORMS += \
 
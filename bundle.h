@@ -0,0 +1,171 @@
+#ifndef BUNDLE_H
+#define BUNDLE_H
+
+#include <QDebug>
+#include <QFile>
+#include <QImage>
+#include <QScopedPointer>
+#include <QString>
+#include <QStringList>
+#include <QtEndian>
+#include <climits>
+#include <cstring>
+
+// Packed slideshow bundle (*.vqb)
+//
+// One file holding pre-scaled images, the playlist order and per-image
+// metadata, laid out so the whole thing can be mmap'd and each image handed
+// out as a QImage that points straight into the mapping (no copy, no decode).
+//
+//   BundleHeader
+//   pixel data, each image aligned to BundleAlignment
+//   BundleEntry[entryCount]          <- index at header.indexOffset, in playlist order
+//   UTF-8 name table                 <- directly after the index
+//
+// All integers are little endian.
+
+static const char BundleMagic[8] = { 'V', 'Q', 'B', 'N', 'D', 'L', '1', '\0' };
+static const quint32 BundleVersion = 1;
+static const quint32 BundleAlignment = 64;
+
+struct BundleHeader {
+    char magic[8];
+    quint32 version;
+    quint32 entryCount;
+    quint32 displayWidth;   // resolution the images were scaled for
+    quint32 displayHeight;
+    quint64 indexOffset;
+};
+
+struct BundleEntry {
+    quint64 dataOffset;
+    quint32 width;
+    quint32 height;
+    quint32 bytesPerLine;
+    quint32 format;         // QImage::Format
+    quint32 nameOffset;     // into the name table
+    quint32 nameLength;
+    quint32 sourceWidth;    // size of the original file before scaling
+    quint32 sourceHeight;
+};
+
+static_assert(sizeof(BundleHeader) == 32, "BundleHeader layout changed");
+static_assert(sizeof(BundleEntry) == 40, "BundleEntry layout changed");
+
+class SlideBundle {
+public:
+    SlideBundle() : data(nullptr), size(0), header(nullptr), entries(nullptr), nameTable(0) {}
+    ~SlideBundle() { close(); }
+
+    static bool isBundle(const QString& path) {
+        return path.endsWith(".vqb", Qt::CaseInsensitive);
+    }
+
+    // Maps and validates the new file before letting go of the current one,
+    // so a bad bundle leaves whatever was open untouched.
+    bool open(const QString& path) {
+        QScopedPointer<QFile> next(new QFile(path));
+        if (!next->open(QIODevice::ReadOnly)) return false;
+
+        const qint64 nextSize = next->size();
+        uchar* nextData = next->map(0, nextSize);
+        qint64 nextNameTable = 0;
+        if (!nextData || !validate(nextData, nextSize, &nextNameTable)) {
+            qWarning() << "Not a valid slideshow bundle:" << path;
+            return false;   // next unmaps on destruction
+        }
+
+        close();
+        file.swap(next);
+        data = nextData;
+        size = nextSize;
+        header = reinterpret_cast<const BundleHeader*>(data);
+        entries = reinterpret_cast<const BundleEntry*>(data + qFromLittleEndian(header->indexOffset));
+        nameTable = nextNameTable;
+
+        names.reserve(count());
+        for (int i = 0; i < count(); ++i) {
+            const BundleEntry& e = entries[i];
+            const char* name = reinterpret_cast<const char*>(data) + nameTable + qFromLittleEndian(e.nameOffset);
+            names << QString::fromUtf8(name, int(qFromLittleEndian(e.nameLength)));
+        }
+        return true;
+    }
+
+    void close() {
+        if (file && data) file->unmap(data);
+        file.reset();
+        data = nullptr;
+        size = 0;
+        header = nullptr;
+        entries = nullptr;
+        nameTable = 0;
+        names.clear();
+    }
+
+    bool isOpen() const { return data != nullptr; }
+    QString path() const { return file ? file->fileName() : QString(); }
+    int count() const { return header ? int(qFromLittleEndian(header->entryCount)) : 0; }
+    QStringList playlist() const { return names; }
+
+    // Zero-copy view into the mapping; only valid while the bundle stays open.
+    // The pixels are const, so anything that paints on the image detaches first.
+    QImage image(int index) const {
+        if (index < 0 || index >= count()) return QImage();
+        const BundleEntry& e = entries[index];
+        const uchar* pixels = data + qFromLittleEndian(e.dataOffset);
+        return QImage(pixels,
+                      int(qFromLittleEndian(e.width)), int(qFromLittleEndian(e.height)),
+                      int(qFromLittleEndian(e.bytesPerLine)),
+                      QImage::Format(qFromLittleEndian(e.format)));
+    }
+
+private:
+    QScopedPointer<QFile> file;
+    uchar* data;
+    qint64 size;
+    const BundleHeader* header;
+    const BundleEntry* entries;
+    qint64 nameTable;
+    QStringList names;
+
+    static bool validate(const uchar* data, qint64 size, qint64* nameTable) {
+        if (size < qint64(sizeof(BundleHeader))) return false;
+        const BundleHeader* header = reinterpret_cast<const BundleHeader*>(data);
+        if (memcmp(header->magic, BundleMagic, sizeof(BundleMagic)) != 0) return false;
+        if (qFromLittleEndian(header->version) != BundleVersion) return false;
+
+        const quint32 count = qFromLittleEndian(header->entryCount);
+        const quint64 indexOffset = qFromLittleEndian(header->indexOffset);
+        const quint64 indexSize = quint64(count) * sizeof(BundleEntry);
+        if (count > quint32(INT_MAX)) return false;
+        if (indexOffset > quint64(size) || indexSize > quint64(size) - indexOffset) return false;
+        if (indexOffset % alignof(BundleEntry) != 0) return false;
+
+        const BundleEntry* entries = reinterpret_cast<const BundleEntry*>(data + indexOffset);
+        *nameTable = qint64(indexOffset + indexSize);
+
+        for (quint32 i = 0; i < count; ++i) {
+            const BundleEntry& e = entries[i];
+            const quint64 nameEnd = quint64(*nameTable) + qFromLittleEndian(e.nameOffset) + qFromLittleEndian(e.nameLength);
+            if (nameEnd > quint64(size)) return false;
+
+            const quint64 width = qFromLittleEndian(e.width);
+            const quint64 height = qFromLittleEndian(e.height);
+            const quint64 bpl = qFromLittleEndian(e.bytesPerLine);
+            const quint32 format = qFromLittleEndian(e.format);
+            if (format != QImage::Format_RGB32 && format != QImage::Format_ARGB32_Premultiplied) return false;
+            if (width == 0 || height == 0 || width > INT_MAX || height > INT_MAX || bpl > INT_MAX) return false;
+            if (bpl < width * 4) return false;
+
+            // QImage reads these formats a 32-bit pixel at a time straight
+            // out of the mapping, so every row has to start 4-byte aligned
+            const quint64 offset = qFromLittleEndian(e.dataOffset);
+            if (offset % 4 != 0 || bpl % 4 != 0) return false;
+            if (offset > quint64(size) || bpl * height > quint64(size) - offset) return false;
+        }
+        return true;
+    }
+};
+
+#endif // BUNDLE_H
@@ -0,0 +1,23 @@
+#ifndef IMAGEFORMAT_H
+#define IMAGEFORMAT_H
+
+#include <QImage>
+
+// QPixmap on the raster backend stores opaque images as RGB32 and everything
+// else as ARGB32_Premultiplied. Smooth scaling, QPainter composition and
+// QPixmap::fromImage() all have SIMD paths for exactly those two formats;
+// any other format (paletted GIF, 16-bit or grayscale PNG, CMYK JPEG, ...)
+// is converted through a generic per-pixel path every time it is touched.
+inline QImage::Format nativeFormat(const QImage& image) {
+    return image.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32;
+}
+
+// Converts a freshly decoded image once, so everything downstream stays on the
+// fast path. Safe to call from worker threads.
+inline QImage normalizeImage(const QImage& image) {
+    if (image.isNull()) return image;
+    QImage::Format format = nativeFormat(image);
+    return image.format() == format ? image : image.convertToFormat(format);
+}
+
+#endif // IMAGEFORMAT_H
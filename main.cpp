@@ -17,17 +17,34 @@
 #include <QLabel>
 #include <QMovie>
 #include <QRandomGenerator>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QTemporaryDir>
+#include <QScopedPointer>
+
+#include "bundle.h"
+#include "imageformat.h"
+#include "panepool.h"
+#include "prefetch.h"
+#include "presentation.h"
+#include "soak.h"
+#include "timing.h"
+
 class ImageViewer : public QMainWindow {
     Q_OBJECT
 
 public:
     ImageViewer(QWidget *parent = nullptr)
-        : QMainWindow(parent), currentIndex(0), slideshowRunning(false), fullscreen(false), slideshowMode(Single) {
+        : QMainWindow(parent), currentIndex(0), slideshowRunning(false), fullscreen(false), presentDeadline(250),
+          slideshowMode(Single), slideshowInterval(13000), rng(QRandomGenerator::securelySeeded()), tickLimit(0), tickInFlight(false) {
         setWindowTitle("Fancy Image Viewer");
         setMinimumSize(800, 600);
         setAcceptDrops(true);
 
         scene = new QGraphicsScene(this);
+        // Panes sit on a fixed grid and are few; a BSP index only costs upkeep
+        scene->setItemIndexMethod(QGraphicsScene::NoIndex);
         view = new QGraphicsView(scene, this);
         view->installEventFilter(this);
 
@@ -36,51 +53,121 @@ public:
         view->setAcceptDrops(false);
         setCentralWidget(view);
 
-        initData(6);
+        panes = new PanePool(scene);
 
         btext=false;
         view->setBackgroundBrush(Qt::black);  // or any QColor
         slideshowTimer = new QTimer(this);
-        connect(slideshowTimer, &QTimer::timeout, this, &ImageViewer::tickSlideshow);
+        connect(slideshowTimer, &QTimer::timeout, this, [this]() {
+            prefetcher->noteSlideshowTick();
+            tickSlideshow();
+        });
+
+        prefetcher = new PrefetchScheduler(this);
+        prefetcher->setLoader([this](const PrefetchRequest& r) { return decodeScaled(r); });
+        connect(prefetcher, &PrefetchScheduler::imageReady, this, &ImageViewer::paneImageReady);
+
+        presenter = new PresentationStage(this);
+        connect(presenter, &PresentationStage::transitionStarted, this, &ImageViewer::completeTickIfPresented);
 
         setupMenu();
     }
 
-    void initData(int count) {
-        for (int i = 0; i < count; ++i) {
-            QGraphicsPixmapItem *item = new QGraphicsPixmapItem();
-            QGraphicsOpacityEffect *effect = new QGraphicsOpacityEffect();
-            QPropertyAnimation *anim = new QPropertyAnimation(effect, "opacity", this);
-            anim->setDuration(800);
-            anim->setStartValue(0.0);
-            anim->setEndValue(1.0);
+    ~ImageViewer() override {
+        // Workers read from the bundle and call back into us; stop them first
+        prefetcher->reset();
+        delete panes;   // before the scene goes, it owns the panes still in it
+    }
+
+    // Folder, single image or .vqb bundle, as if it had been dropped on the window.
+    void openPath(const QString& path) {
+        QFileInfo info(path);
+        if (info.isDir()) {
+            loadImagesFromFolder(path);
+        } else if (info.isFile() && SlideBundle::isBundle(path)) {
+            loadBundle(path);
+        } else if (info.isFile()) {
+            loadImagesFromFolder(info.absolutePath(), info.fileName());
+        }
+    }
+
+    int imageCount() const { return images.size(); }
+
+    void setSlideshowInterval(int msecs) { slideshowInterval = qMax(0, msecs); }
+    void setRandomSeed(quint32 seed) { rng.seed(seed); }
+    void setPrefetchDepth(int depth) { prefetcher->setDepth(depth); }
+    void setCacheBudget(qint64 bytes) { prefetcher->setCacheBudget(bytes); }
+
+    void setFullscreen(bool on) {
+        if (on != fullscreen) toggleFullscreen();
+    }
 
-            item->setGraphicsEffect(effect);
-            pixmapItems.append(item);
-            opacityEffects.append(effect);
-            animations.append(anim);
-            scene->addItem(item);
+    // Single, FourPane or SixPane; used by the next open, tick or slideshow.
+    void setSlideshowMode(int paneCount) {
+        slideshowMode = paneCount == SixPane ? SixPane : paneCount == FourPane ? FourPane : Single;
+    }
 
-            movies.append(nullptr);
+    // Does nothing until images are loaded.
+    void startSlideshow(int paneCount) {
+        setSlideshowMode(paneCount);
+        if (!images.isEmpty()) {
+            slideshowRunning = true;
+            slideshowTimer->start(slideshowInterval);
         }
     }
 
+    // What --soak drives and watches. Actions run far faster than a slideshow;
+    // probes count objects that leak if panes or movies are not recycled and
+    // connections that pile up on the senders that live as long as the viewer.
+    void attachSoak(SoakRunner *soak) {
+        soak->addAction("tick", 6, [this]() { tickSlideshow(); });
+        soak->addAction("next", 2, [this]() { prefetcher->noteNavigation(1); nextImage(); });
+        soak->addAction("prev", 2, [this]() { prefetcher->noteNavigation(-1); prevImage(); });
+        soak->addAction("resize", 1, [this]() { resize(rng.bounded(800, 1920), rng.bounded(600, 1200)); });
+        soak->addAction("mode", 1, [this]() {
+            slideshowMode = slideshowMode == Single ? FourPane : slideshowMode == FourPane ? SixPane : Single;
+            tickSlideshow();
+        });
+
+        soak->addProbe("qobjects", 64, [this]() { return qint64(findChildren<QObject*>().size()); });
+        soak->addProbe("scene_items", 8, [this]() { return qint64(scene->items().size()); });
+        // Movies alive but no longer held by a pane; the pool bounds the rest
+        soak->addProbe("orphan_movies", 0, [this]() { return qint64(PaneMovie::liveCount() - panes->movieCount()); });
+        soak->addProbe("connections", 0, [this]() {
+            return qint64(prefetcher->listenerCount() + presenter->listenerCount());
+        });
+        soak->addProbe("prefetch_entries", 16, [this]() { return qint64(prefetcher->cachedCount()); });
+    }
+
+    // Benchmark mode: after this many ticks print the timing report and quit.
+    void exitAfterTicks(int ticks) {
+        tickLimit = ticks;
+        tickReport.start();
+        // Each tick is rearmed once it has been presented, see completeTickIfPresented()
+        slideshowTimer->setSingleShot(true);
+    }
+
 protected:
     void keyPressEvent(QKeyEvent *event) override {
         switch (event->key()) {
         case Qt::Key_Right:
+            prefetcher->noteNavigation(1);
             tickSlideshow();
             break;
         case Qt::Key_Down:
+            prefetcher->noteNavigation(1);
             tickSlideshow();
             break;
         case Qt::Key_Space:
+            prefetcher->noteNavigation(1);
             tickSlideshow();
             break;
         case Qt::Key_Left:
+            prefetcher->noteNavigation(-1);
             prevImage();
             break;
         case Qt::Key_Up:
+            prefetcher->noteNavigation(-1);
             prevImage();
             break;
         case Qt::Key_Escape:
@@ -95,9 +182,11 @@ protected:
     void mousePressEvent(QMouseEvent *event) override {
         if (event->button() == Qt::LeftButton) {
             //   qDebug() << "Left mouse button pressed";
+            prefetcher->noteNavigation(1);
             tickSlideshow();
         } else if (event->button() == Qt::RightButton) {
             //   qDebug() << "Right mouse button pressed";
+            prefetcher->noteNavigation(1);
             tickSlideshow();
         }
     }
@@ -132,6 +221,10 @@ protected:
         // QDir dir(folderPath);
         QStringList filters = { "*.jpg", "*.jpeg", "*.png", "*.bmp", "*.gif" };
 
+        prefetcher->reset();
+        upcoming.clear();
+        hideAllPanes();   // their pixmaps may still share the bundle's mapping
+        bundle.close();
         images.clear();
         QDir dir(folderPath);
         QDirIterator it(folderPath, filters, QDir::Files, QDirIterator::Subdirectories);
@@ -140,6 +233,7 @@ protected:
             QString relative = dir.relativeFilePath(filePath);  // Strips base path
             images << relative;  // e.g., just "cat.jpg"
         }
+        images.sort();  // directory order is filesystem dependent; keep runs reproducible
 
         this->folderPath = folderPath;
 
@@ -150,7 +244,7 @@ protected:
             currentIndex = 0;
         }
 
-        loadImage(currentIndex, 0, view->viewport()->size());
+        showCurrent();
     }
 
     void dropEvent(QDropEvent *event) override {
@@ -159,47 +253,32 @@ protected:
             QList<QUrl> urls = event->mimeData()->urls();
             if (urls.isEmpty()) return;
 
-            QString path = urls.first().toLocalFile();
-            QFileInfo info(path);
-
-            if (info.isDir()) {
-                loadImagesFromFolder(path);
-            } else if (info.isFile()) {
-                loadImagesFromFolder(info.absolutePath(), info.fileName());
-            }
+            openPath(urls.first().toLocalFile());
             event->acceptProposedAction();
         }
     }
 
 private slots:
     void openImage() {
-        QString imagePath = QFileDialog::getOpenFileName(this, "Open Image", QDir::homePath(), "Images (*.png *.jpg *.jpeg *.bmp *.gif)");
-        if (!imagePath.isEmpty()) {
+        QString imagePath = QFileDialog::getOpenFileName(this, "Open Image", QDir::homePath(),
+                                                         "Images (*.png *.jpg *.jpeg *.bmp *.gif);;Slideshow bundles (*.vqb)");
+        if (imagePath.isEmpty()) return;
+
+        if (SlideBundle::isBundle(imagePath))
+            loadBundle(imagePath);
+        else
             loadImagesFromFile(imagePath);
-        }
     }
 
     void startSlideshowSingle() {
-        slideshowMode = Single;
-        if (!images.isEmpty()) {
-            slideshowRunning = true;
-            slideshowTimer->start(13000);
-        }
+        startSlideshow(Single);
     }
     void startSlideshowSix() {
-        slideshowMode = SixPane;
-        if (!images.isEmpty()) {
-            slideshowRunning = true;
-            slideshowTimer->start(13000);
-        }
+        startSlideshow(SixPane);
     }
 
     void startSlideshowFour() {
-        slideshowMode = FourPane;
-        if (!images.isEmpty()) {
-            slideshowRunning = true;
-            slideshowTimer->start(13000);
-        }
+        startSlideshow(FourPane);
     }
 
     void stopSlideshow() {
@@ -218,22 +297,26 @@ private slots:
     }
 
     void tickSlideshow() {
+        if (tickLimit > 0) {
+            tickClock.start();
+            tickInFlight = true;
+        }
+
         if (slideshowMode == SixPane)
             loadSixPane();
         else if (slideshowMode == FourPane)
             loadFourPane();
         else
             nextImage();
+
+        completeTickIfPresented();
     }
 
 private:
     QGraphicsView *view;
     QGraphicsScene *scene;
 
-    QVector<QGraphicsPixmapItem*> pixmapItems;
-    QVector<QGraphicsOpacityEffect*> opacityEffects;
-    QVector<QPropertyAnimation*> animations;
-    QVector<QMovie*> movies;
+    PanePool *panes;
 
     QTimer *slideshowTimer;
     bool slideshowRunning;
@@ -241,12 +324,67 @@ private:
 
     QStringList images;
     QString folderPath;
+    SlideBundle bundle;   // when open, images/folderPath describe the bundle instead of a folder
+
+    PrefetchScheduler *prefetcher;
+    QVector<int> upcoming;   // panes for the next grid tick, picked early so they can be prefetched
+
+    PresentationStage *presenter;
+    int presentDeadline;     // ms a tick waits for all of its panes before fading in what it has
+
+    struct PendingPane {
+        int showIndex;
+        PrefetchRequest request;
+    };
+    QVector<PendingPane> pendingPanes;   // grid panes still decoding this tick
+
     int currentIndex;
     bool btext;
 
     enum Mode { Single, FourPane = 4, SixPane = 6 };
 
     Mode slideshowMode;
+    int slideshowInterval;
+    QRandomGenerator rng;     // pane picker; seeded from --seed for reproducible runs
+
+    int tickLimit;            // --ticks, 0 when not benchmarking
+    bool tickInFlight;
+    QElapsedTimer tickClock;
+    TimingReport tickReport;
+
+    // --ticks: a tick is done once its transition has started with every pane
+    // on screen. Only then is its latency recorded and the next tick armed, so
+    // each run does the same decode work whatever the thread timing.
+    void completeTickIfPresented() {
+        if (tickLimit == 0 || !tickInFlight) return;
+        if (presenter->isHolding() || !pendingPanes.isEmpty()) return;
+
+        tickInFlight = false;
+        tickReport.add(tickClock.nsecsElapsed());
+        if (tickReport.count() >= tickLimit)
+            finishTickRun();
+        else if (slideshowRunning)
+            slideshowTimer->start(slideshowInterval);
+    }
+
+    void finishTickRun() {
+        stopSlideshow();
+        tickLimit = 0;
+
+        QTextStream out(stdout);
+        out << "mode: " << (slideshowMode == Single ? 1 : int(slideshowMode)) << "\n"
+            << "interval_ms: " << slideshowInterval << "\n"
+            << "images: " << images.size() << "\n"
+            << tickReport.summary()
+            << "prefetch_hits: " << prefetcher->cacheHits() << "\n"
+            << "prefetch_waits: " << prefetcher->cacheWaits() << "\n"
+            << "prefetch_misses: " << prefetcher->cacheMisses() << "\n"
+            << "transitions_presented: " << presenter->presentedCount() << "\n"
+            << "transitions_missed_deadline: " << presenter->missedCount() << "\n";
+        out.flush();
+
+        QCoreApplication::exit(0);
+    }
 
     void setupMenu() {
         QMenu *fileMenu = menuBar()->addMenu("File");
@@ -270,20 +408,44 @@ private:
     void loadImagesFromFile(const QString &imagePath) {
         if (!QFileInfo(imagePath).exists()) return;
 
+        prefetcher->reset();
+        upcoming.clear();
+        hideAllPanes();   // their pixmaps may still share the bundle's mapping
+        bundle.close();
         QDir dir = QFileInfo(imagePath).absoluteDir();
         QStringList filters = {"*.png", "*.jpg", "*.jpeg", "*.bmp", "*.gif"};
         images = dir.entryList(filters, QDir::Files, QDir::Name);
         folderPath = dir.absolutePath();
         currentIndex = images.indexOf(QFileInfo(imagePath).fileName());
 
-        QTimer::singleShot(50, [this]() {
-            if (slideshowMode == SixPane)
-                loadSixPane();
-            else if (slideshowMode == FourPane)
-                loadFourPane();
-            else
-                loadImage(currentIndex, 0, view->viewport()->size());
-        });
+        QTimer::singleShot(50, [this]() { showCurrent(); });
+    }
+
+    void loadBundle(const QString &bundlePath) {
+        prefetcher->reset();
+        upcoming.clear();
+        hideAllPanes();   // open() unmaps the current bundle, which the pixmaps may share
+        // On failure the previous folder or bundle stays open and images/folderPath still match it
+        if (!bundle.open(bundlePath)) {
+            showCurrent();
+            return;
+        }
+
+        images = bundle.playlist();
+        folderPath = bundle.path();
+        currentIndex = 0;
+
+        showCurrent();
+    }
+
+    // The current image, or a fresh grid, in the current mode.
+    void showCurrent() {
+        if (slideshowMode == SixPane)
+            loadSixPane();
+        else if (slideshowMode == FourPane)
+            loadFourPane();
+        else
+            loadImage(currentIndex, 0, view->viewport()->size());
     }
 
     bool isGif(const QString& filePath) {
@@ -291,14 +453,9 @@ private:
     }
 
     void hideAllPanes() {
-        for (int i = 0; i < pixmapItems.size(); ++i) {
-            pixmapItems[i]->setVisible(false);
-            animations[i]->stop();
-            QMovie* movie = movies[i];
-            if (movie) {
-                delete movie; movies[i] = nullptr;
-            }
-        }
+        presenter->cancel();
+        pendingPanes.clear();
+        panes->releaseAll();
     }
 
     void loadImage(int index, int showIndex, const QSize& scaledSize, bool onlyShowOne = true) {
@@ -308,39 +465,66 @@ private:
         // Show only the first pixmap item
         if (onlyShowOne)   {
              hideAllPanes();
-             pixmapItems[showIndex]->setVisible(true);
+             presenter->begin(1, presentDeadline);
         }
 
-        if (isGif(imagePath)) {
-            QMovie* movie = new QMovie(imagePath); movies[showIndex] = movie;
+        Pane& pane = panes->acquire(showIndex);
+        pane.item->setPos(0, 0);
+        pane.item->setScale(1.0);
+
+        // The fade is started by the presenter once the whole tick is ready
+        pane.fade->stop();
+        pane.effect->setOpacity(0.0);
+
+        if (!bundle.isOpen() && isGif(imagePath)) {
+            PaneMovie* movie = new PaneMovie(imagePath); pane.movie = movie;
 
             connect(movie, &QMovie::finished, movie, &QMovie::start);  // 👈 Loop manually
 
             movie->setScaledSize(scaledSize);
             movie->start();
-            connect(movie, &QMovie::frameChanged, this, [=]() {
-                pixmapItems[showIndex]->setPixmap(movie->currentPixmap());
+            // Context is the movie, so the connection goes when the pane drops it
+            QGraphicsPixmapItem *item = pane.item;
+            connect(movie, &QMovie::frameChanged, movie, [item, movie]() {
+                item->setPixmap(movie->currentPixmap());
             });
+            presenter->stage(pane.fade);
+        } else if (onlyShowOne) {
+            QGraphicsPixmapItem *item = pane.item;   // `pane` dangles once showPane() acquires again
+            showPane(showIndex, prefetcher->take({ index, imagePath, scaledSize }), imagePath, scaledSize);
+            scene->setSceneRect(item->sceneBoundingRect());
         } else {
-            QPixmap pix(imagePath);
-            if (pix.isNull()) return;         
-
-            //  pix = pix.scaled(scaledSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
-            QPixmap scaled = pix.scaled(scaledSize.width(), scaledSize.height(), Qt::KeepAspectRatio, Qt::SmoothTransformation);
+            // Grid panes don't block on decoding; late ones arrive via paneImageReady()
+            PrefetchRequest request = { index, imagePath, scaledSize };
+            QImage image;
+            if (prefetcher->takeIfReady(request, &image)) {
+                showPane(showIndex, image, imagePath, scaledSize);
+            } else {
+                pane.item->setPixmap(QPixmap());
+                pendingPanes.append({ showIndex, request });
+            }
+        }
 
-            // Create a new pixmap to paint image + text shadow
-            QPixmap composed(scaled.size());
-            composed.fill(Qt::transparent);
+        if (onlyShowOne)
+            schedulePrefetch();
+    }
 
-            QPainter painter(&composed);
-            painter.setRenderHint(QPainter::Antialiasing);
-            painter.setRenderHint(QPainter::TextAntialiasing);
-            painter.drawPixmap(0, 0, scaled);
+    // Sets a decoded pane's pixmap (with caption) and hands its fade to the presenter.
+    void showPane(int showIndex, QImage image, const QString& imagePath, const QSize& fitSize) {
+        Pane& pane = panes->acquire(showIndex);
+        if (!image.isNull()) {
+            // Bundle slices may be near, not at, the pane size; the item takes up the rest
+            pane.item->setScale(fitScale(image.size(), fitSize));
 
-            // Draw the scaled image
+            // The image is already scaled and in the pixmap's native format, so the
+            // caption goes straight onto it and fromImage() below is a plain copy
             if(btext){
+                QPainter painter(&image);
+                painter.setRenderHint(QPainter::Antialiasing);
+                painter.setRenderHint(QPainter::TextAntialiasing);
+
                 // Optionally draw translucent black rect behind text for readability
-                QRect textRect(0, composed.height() - 30, composed.width(), 30);
+                QRect textRect(0, image.height() - 30, image.width(), 30);
                 painter.setBrush(QColor(0, 0, 0, 100)); // translucent black
                 painter.setPen(Qt::NoPen);
                 painter.drawRect(textRect);
@@ -365,29 +549,104 @@ private:
 
                 painter.end();
             }
-            pixmapItems[showIndex]->setPixmap(composed);
-            scene->setSceneRect(pixmapItems[showIndex]->boundingRect());
+            pane.item->setPixmap(QPixmap::fromImage(image));
         }
+        presenter->stage(pane.fade);
+    }
 
-        pixmapItems[showIndex]->setPos(0, 0);
+    void paneImageReady(int index, const QSize& size) {
+        for (int i = 0; i < pendingPanes.size(); ++i) {
+            const PendingPane pane = pendingPanes[i];
+            if (pane.request.index != index || pane.request.size != size) continue;
 
-        animations[showIndex]->stop();
-        opacityEffects[showIndex]->setOpacity(0.0);
-        animations[showIndex]->start();
+            // Already counted as a prefetch miss when it went pending
+            QImage image;
+            if (!prefetcher->takeIfReady(pane.request, &image, false)) continue;
+            pendingPanes.removeAt(i--);
+            showPane(pane.showIndex, image, pane.request.path, pane.request.size);
+        }
+        completeTickIfPresented();
     }
 
-    void loadSixPane() {
-        slideshowMode = SixPane;
-        if (images.size() < SixPane) return;
+    // Runs on prefetch worker threads as well as the GUI thread. Normalizing
+    // before scaling keeps the smooth scaler off its generic conversion path.
+    QImage decodeScaled(const PrefetchRequest& r) const {
+        // Bundle images are already at display resolution and in a native format.
+        // Close to the pane size (the window is the display minus its menu bar
+        // and frame) the slice is shown as is and showPane() scales the item;
+        // only grid tiles, a fraction of the display, get a real downscale.
+        QImage image = bundle.isOpen() ? bundle.image(r.index) : normalizeImage(QImage(r.path));
+        if (image.isNull()) return image;
+        if (bundle.isOpen() && fitScale(image.size(), r.size) >= 0.75) return image;
+        // Smooth scaling keeps the 32-bit native formats, so no second conversion
+        return image.scaled(r.size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    }
 
-        hideAllPanes();
+    // Scale that fits `image` into `box` keeping its aspect ratio.
+    static qreal fitScale(const QSize& image, const QSize& box) {
+        if (image.isEmpty() || box.isEmpty()) return 1.0;
+        return qMin(qreal(box.width()) / image.width(), qreal(box.height()) / image.height());
+    }
 
+    QVector<int> pickPanes(int count) {
         QVector<int> indexes;
-        while (indexes.size() < SixPane) {
-            int idx = QRandomGenerator::global()->bounded(images.size());
+        while (indexes.size() < count) {
+            int idx = rng.bounded(images.size());
             if (indexes.contains(idx)) continue;
             indexes.append(idx);
         }
+        return indexes;
+    }
+
+    // Panes for this tick (the ones prefetched last time, if still valid) and
+    // a fresh pick for the next one.
+    QVector<int> takeUpcomingPanes(int count) {
+        QVector<int> indexes = upcoming.size() == count ? upcoming : pickPanes(count);
+        upcoming = pickPanes(count);
+        return indexes;
+    }
+
+    // Tell the prefetcher what the next tick or keypress will show and when.
+    void schedulePrefetch() {
+        if (images.isEmpty()) return;
+        prefetcher->setDeadline(slideshowRunning ? slideshowTimer->remainingTime() : -1);
+
+        QVector<PrefetchRequest> wanted;
+        auto want = [&](int index, const QSize& size) {
+            index = (index % images.size() + images.size()) % images.size();
+            QString imagePath = folderPath + "/" + images[index];
+            if (!bundle.isOpen() && isGif(imagePath)) return;
+            wanted.append({ index, imagePath, size });
+        };
+
+        QSize viewportSize = view->viewport()->size();
+        if (slideshowMode == Single) {
+            // Keep the current image, then look ahead in the direction of travel
+            // and one step back.
+            int dir = prefetcher->direction();
+            for (int step = 0; step <= prefetcher->lookahead(); ++step)
+                want(currentIndex + dir * step, viewportSize);
+            want(currentIndex - dir, viewportSize);
+        } else {
+            // Panes still missing from this tick come before the next tick's
+            int cols = slideshowMode == SixPane ? 3 : 2;
+            QSize tileSize(viewportSize.width() / cols, viewportSize.height() / 2);
+            for (const PendingPane& pane : pendingPanes)
+                wanted.append(pane.request);
+            for (int index : upcoming)
+                want(index, tileSize);
+        }
+        prefetcher->request(wanted, pendingPanes.size());
+    }
+
+    void loadSixPane() {
+        slideshowMode = SixPane;
+        if (images.size() < SixPane) return;
+
+        hideAllPanes();
+        presenter->begin(SixPane, presentDeadline);
+
+        QVector<int> indexes = takeUpcomingPanes(SixPane);
         int i = 0;
         QSize viewportSize = view->viewport()->size();
         int w = viewportSize.width() / 3;
@@ -399,13 +658,13 @@ private:
 
             int row = i / 3;
             int col = i % 3;
-            pixmapItems[i]->setPos(col * w, row * h);
-            pixmapItems[i]->setVisible(true);
+            panes->acquire(i).item->setPos(col * w, row * h);
 
             ++i;
         }
 
         scene->setSceneRect(0, 0, viewportSize.width(), viewportSize.height());
+        schedulePrefetch();
     }
 
 
@@ -414,13 +673,9 @@ private:
         if (images.size() < FourPane) return;
 
         hideAllPanes();
+        presenter->begin(FourPane, presentDeadline);
 
-        QVector<int> indexes;
-        while (indexes.size() < FourPane) {
-            int idx = QRandomGenerator::global()->bounded(images.size());
-            if (indexes.contains(idx)) continue;
-            indexes.append(idx);
-        }
+        QVector<int> indexes = takeUpcomingPanes(FourPane);
 
         int i = 0;
         QSize viewportSize = view->viewport()->size();
@@ -432,12 +687,12 @@ private:
             loadImage(index, i, scaledSize, false);
             int row = i / 2;
             int col = i % 2;
-            pixmapItems[i]->setPos(col * w, row * h);
-            pixmapItems[i]->setVisible(true);
+            panes->acquire(i).item->setPos(col * w, row * h);
             ++i;
         }
 
         scene->setSceneRect(0, 0, viewportSize.width(), viewportSize.height());
+        schedulePrefetch();
     }
 
     void nextImage() {
@@ -455,9 +710,107 @@ private:
 
 
 int main(int argc, char *argv[]) {
+    // Soak runs are unattended; they don't need a display
+    for (int i = 1; i < argc; ++i) {
+        bool soak = qstrcmp(argv[i], "--soak") == 0 || qstrncmp(argv[i], "--soak=", 7) == 0;
+        if (soak && !qEnvironmentVariableIsSet("QT_QPA_PLATFORM"))
+            qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
     QApplication app(argc, argv);
+    QApplication::setApplicationName("ViewQ");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Image viewer with single, 4-pane and 6-pane slideshows.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("path", "Image, folder or .vqb bundle to open.", "[path]");
+
+    QCommandLineOption modeOption("mode", "Slideshow pane mode: single, 4 or 6.", "mode", "single");
+    QCommandLineOption intervalOption("interval", "Slideshow interval in milliseconds.", "ms", "13000");
+    QCommandLineOption seedOption("seed", "Seed for picking panes, for reproducible runs.", "n");
+    QCommandLineOption slideshowOption("slideshow", "Start the slideshow straight away.");
+    QCommandLineOption fullscreenOption("fullscreen", "Start fullscreen.");
+    QCommandLineOption depthOption("prefetch-depth", "Images to decode ahead of the current one.", "n", "2");
+    QCommandLineOption cacheOption("cache-mb", "Prefetch cache budget in MiB.", "mb", "256");
+    QCommandLineOption ticksOption("ticks", "Run N slideshow ticks, print a timing report and exit.", "n");
+    QCommandLineOption soakOption("soak", "Soak test: drive the viewer for this many seconds, print resource use and fail on growth.", "seconds");
+    QCommandLineOption soakRateOption("soak-rate", "Milliseconds between soak actions.", "ms", "20");
+    QCommandLineOption soakCorpusOption("soak-corpus", "Synthetic images to generate when soaking without a path.", "n", "1000");
+    parser.addOptions({ modeOption, intervalOption, seedOption, slideshowOption, fullscreenOption,
+                        depthOption, cacheOption, ticksOption, soakOption, soakRateOption, soakCorpusOption });
+    parser.process(app);
+
+    auto intValue = [&](const QCommandLineOption& option, int minimum) {
+        bool ok = false;
+        int value = parser.value(option).toInt(&ok);
+        if (!ok || value < minimum) {
+            qWarning().noquote() << "Invalid value for --" + option.names().first() + ":" << parser.value(option);
+            parser.showHelp(1);
+        }
+        return value;
+    };
+
+    QString mode = parser.value(modeOption);
+    int panes = mode == "6" || mode == "six" ? 6 : mode == "4" || mode == "four" ? 4 : 1;
+    if (panes == 1 && mode != "1" && mode != "single") {
+        qWarning().noquote() << "Invalid value for --mode:" << mode;
+        parser.showHelp(1);
+    }
+
+    const QStringList args = parser.positionalArguments();
+    QString path = args.isEmpty() ? QString() : args.first();
+    int ticks = parser.isSet(ticksOption) ? intValue(ticksOption, 1) : 0;
+    if (ticks > 0 && path.isEmpty()) {
+        qWarning() << "--ticks needs a path to play";
+        return 1;
+    }
+
+    int soakSeconds = parser.isSet(soakOption) ? intValue(soakOption, 1) : 0;
+    quint32 seed = parser.isSet(seedOption) ? quint32(intValue(seedOption, 0)) : 1;
+    QScopedPointer<QTemporaryDir> corpus;   // only created when it is needed
+    if (soakSeconds > 0 && path.isEmpty()) {
+        corpus.reset(new QTemporaryDir);
+        int count = intValue(soakCorpusOption, 1);
+        qInfo() << "Generating" << count << "synthetic images in" << corpus->path();
+        if (!corpus->isValid() || !SoakRunner::writeSyntheticCorpus(corpus->path(), count, seed)) {
+            qWarning() << "Could not write the synthetic corpus";
+            return 1;
+        }
+        path = corpus->path();
+    }
+
     ImageViewer viewer;
+    viewer.setSlideshowInterval(intValue(intervalOption, 0));
+    viewer.setPrefetchDepth(intValue(depthOption, 0));
+    viewer.setCacheBudget(qint64(intValue(cacheOption, 0)) * 1024 * 1024);
+    if (parser.isSet(seedOption))
+        viewer.setRandomSeed(quint32(intValue(seedOption, 0)));
+
+    viewer.setSlideshowMode(panes);
     viewer.show();
+    viewer.setFullscreen(parser.isSet(fullscreenOption));
+
+    if (!path.isEmpty())
+        viewer.openPath(path);
+    if ((ticks > 0 || soakSeconds > 0) && viewer.imageCount() == 0) {
+        qWarning() << "No images to play in" << path;
+        return 1;
+    }
+
+    if (soakSeconds > 0) {
+        SoakRunner *soak = new SoakRunner(&viewer);
+        soak->setDuration(qint64(soakSeconds) * 1000);
+        soak->setRate(intValue(soakRateOption, 0));
+        soak->setSeed(seed);
+        viewer.attachSoak(soak);
+        soak->start();
+        return app.exec();
+    }
+    if (ticks > 0)
+        viewer.exitAfterTicks(ticks);
+    if (ticks > 0 || parser.isSet(slideshowOption))
+        viewer.startSlideshow(panes);
+
     return app.exec();
 }
 #include "main.moc"
@@ -0,0 +1,108 @@
+#ifndef PANEPOOL_H
+#define PANEPOOL_H
+
+#include <QGraphicsOpacityEffect>
+#include <QGraphicsPixmapItem>
+#include <QGraphicsScene>
+#include <QMovie>
+#include <QPixmap>
+#include <QPropertyAnimation>
+#include <QVector>
+
+// A pane's GIF player. Counts its instances, so the soak run can tell a
+// movie that fell out of the pool from one a pane still holds.
+class PaneMovie : public QMovie {
+public:
+    explicit PaneMovie(const QString& fileName) : QMovie(fileName) { ++live(); }
+    ~PaneMovie() override { --live(); }
+
+    // GUI thread only, like the movies themselves.
+    static int liveCount() { return live(); }
+
+private:
+    static int& live() {
+        static int count = 0;
+        return count;
+    }
+};
+
+// Everything one slideshow pane needs in the scene.
+struct Pane {
+    QGraphicsPixmapItem *item;
+    QGraphicsOpacityEffect *effect;   // owned by item
+    QPropertyAnimation *fade;         // owned by effect
+    PaneMovie *movie;                 // only while showing a GIF
+};
+
+// Scene objects for the panes, created the first time a slot is used and
+// recycled after that, so a 6-pane grid costs nothing until it is shown and
+// larger grids only allocate what they use. Released panes are taken out of
+// the scene, so the scene (and the view's painting) only sees what is on
+// screen.
+class PanePool {
+public:
+    explicit PanePool(QGraphicsScene *scene) : scene(scene) {}
+
+    ~PanePool() {
+        for (Pane& pane : panes) {
+            delete pane.movie;
+            if (!pane.item->scene()) delete pane.item;   // the scene deletes the rest
+        }
+    }
+
+    // The pane for this slot, in the scene and visible. The reference is only
+    // good until the next acquire().
+    Pane& acquire(int slot) {
+        while (panes.size() <= slot)
+            panes.append(create());
+
+        Pane& pane = panes[slot];
+        if (!pane.item->scene()) scene->addItem(pane.item);
+        pane.item->setVisible(true);
+        return pane;
+    }
+
+    // Stops every pane, drops its movie and pixmap and takes it out of the scene.
+    void releaseAll() {
+        for (Pane& pane : panes) {
+            pane.fade->stop();
+            if (pane.movie) {
+                delete pane.movie;
+                pane.movie = nullptr;
+            }
+            if (pane.item->scene()) {
+                scene->removeItem(pane.item);
+                pane.item->setPixmap(QPixmap());
+            }
+        }
+    }
+
+    int allocated() const { return panes.size(); }
+
+    int movieCount() const {
+        int count = 0;
+        for (const Pane& pane : panes)
+            if (pane.movie) ++count;
+        return count;
+    }
+
+private:
+    QGraphicsScene *scene;
+    QVector<Pane> panes;
+
+    Pane create() {
+        Pane pane;
+        pane.item = new QGraphicsPixmapItem();
+        pane.effect = new QGraphicsOpacityEffect();
+        pane.fade = new QPropertyAnimation(pane.effect, "opacity", pane.effect);
+        pane.fade->setDuration(800);
+        pane.fade->setStartValue(0.0);
+        pane.fade->setEndValue(1.0);
+        pane.movie = nullptr;
+
+        pane.item->setGraphicsEffect(pane.effect);
+        return pane;
+    }
+};
+
+#endif // PANEPOOL_H
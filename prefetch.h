@@ -0,0 +1,349 @@
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+#include <QObject>
+#include <QRunnable>
+#include <QSize>
+#include <QString>
+#include <QThread>
+#include <QThreadPool>
+#include <QVector>
+#include <QWaitCondition>
+#include <functional>
+
+// One decoded, scaled image the viewer is going to need.
+struct PrefetchRequest {
+    int index;
+    QString path;
+    QSize size;
+};
+
+// Decodes images ahead of the slideshow on a private thread pool.
+//
+// The viewer tells it what it will show next (request()), when the next
+// slideshow tick is due (setDeadline()) and when the user navigates by hand
+// (noteNavigation()). From that it
+//   - queues decodes in priority order, nearest image first,
+//   - cancels queued or running work that is no longer wanted,
+//   - keeps background decoding to one thread unless the deadline or the
+//     user's navigation speed means it would otherwise fall behind.
+class PrefetchScheduler : public QObject {
+    Q_OBJECT
+
+public:
+    // Called on worker threads and on the GUI thread; must be thread-safe.
+    using Loader = std::function<QImage(const PrefetchRequest&)>;
+
+    explicit PrefetchScheduler(QObject *parent = nullptr)
+        : QObject(parent), depth(2), cacheBudget(256 * 1024 * 1024), decodeMs(50),
+          navIntervalMs(-1), navDirection(1), deadline(-1), hits(0), waits(0), misses(0) {
+        pool.setMaxThreadCount(1);
+        clock.start();
+    }
+
+    ~PrefetchScheduler() override {
+        reset();
+    }
+
+    void setLoader(const Loader& l) { loader = l; }
+
+    void setDepth(int d) { depth = qMax(0, d); }
+    void setCacheBudget(qint64 bytes) { cacheBudget = qMax<qint64>(0, bytes); }
+
+    // Milliseconds until the next slideshow tick, or -1 if none is scheduled.
+    void setDeadline(qint64 msecs) {
+        QMutexLocker lock(&mutex);
+        deadline = msecs < 0 ? -1 : clock.elapsed() + msecs;
+    }
+
+    // Manual navigation: +1 forward, -1 back.
+    void noteNavigation(int dir) {
+        QMutexLocker lock(&mutex);
+        if (navClock.isValid()) {
+            qint64 dt = navClock.restart();
+            navIntervalMs = navIntervalMs < 0 ? dt : (navIntervalMs * 3 + dt) / 4;
+        } else {
+            navClock.start();
+        }
+        navDirection = dir < 0 ? -1 : 1;
+    }
+
+    // Automatic slideshow advance: always forward, and not counted towards the
+    // user's navigation speed.
+    void noteSlideshowTick() {
+        QMutexLocker lock(&mutex);
+        navDirection = 1;
+    }
+
+    int direction() const { return navDirection; }
+
+    // How many images ahead are worth decoding right now.
+    int lookahead() const {
+        QMutexLocker lock(&mutex);
+        return userNavigating() ? depth * 2 : depth;
+    }
+
+    // Receivers of imageReady(); one viewer, one connection.
+    int listenerCount() const { return receivers(SIGNAL(imageReady(int,QSize))); }
+
+    int cachedCount() const {
+        QMutexLocker lock(&mutex);
+        return entries.size();
+    }
+
+    // Hits were decoded when asked for, waits were still decoding and blocked
+    // the GUI thread until done, misses were decoded on demand.
+    int cacheHits() const { return hits; }
+    int cacheWaits() const { return waits; }
+    int cacheMisses() const { return misses; }
+
+    // Replaces the wanted set, highest priority first. Anything not in it is
+    // cancelled or evicted; new entries are queued until the budget is used.
+    // The first `required` entries are on screen already and ignore the budget.
+    void request(const QVector<PrefetchRequest>& wanted, int required = 0) {
+        QMutexLocker lock(&mutex);
+
+        QHash<quint64, int> keep;
+        for (const PrefetchRequest& r : wanted)
+            keep.insert(key(r), 0);
+
+        QHash<quint64, int> onScreen;
+        for (int i = 0; i < qMin(required, int(wanted.size())); ++i)
+            onScreen.insert(key(wanted[i]), 0);
+
+        qint64 bytes = 0;
+        for (auto it = entries.begin(); it != entries.end();) {
+            if (!keep.contains(it.key())) {
+                it = cancel(it);
+                continue;
+            }
+            it->cancelled = false;
+            it->required = onScreen.contains(it.key());
+            // Queued and running decodes count at their estimate, or every call
+            // could queue another full budget on top of them
+            bytes += it->state == Ready ? it->image.sizeInBytes() : it->estimate;
+            ++it;
+        }
+
+        int priority = wanted.size();
+        for (const PrefetchRequest& r : wanted) {
+            --priority;
+            quint64 k = key(r);
+            if (entries.contains(k)) continue;
+
+            qint64 estimate = estimateBytes(r.size);
+            bool speculative = wanted.size() - priority > required;
+            if (speculative && bytes + estimate > cacheBudget) break;
+            bytes += estimate;
+
+            Entry e;
+            e.required = !speculative;
+            e.estimate = estimate;
+            e.job = new Job(this, k, r);
+            entries.insert(k, e);
+            pool.start(e.job, priority);
+        }
+
+        throttle();
+    }
+
+    // The image for r, from the cache if it was prefetched, waiting for it if
+    // it is being decoded, or decoded right here otherwise.
+    QImage take(const PrefetchRequest& r) {
+        quint64 k = key(r);
+        {
+            QMutexLocker lock(&mutex);
+            auto it = entries.find(k);
+            if (it != entries.end() && it->state == Queued && pool.tryTake(it->job)) {
+                delete it->job;
+                entries.erase(it);
+            } else if (it != entries.end()) {
+                it->cancelled = false;
+                bool waited = false;
+                while ((it = entries.find(k)) != entries.end() && it->state != Ready) {
+                    ready.wait(&mutex);
+                    waited = true;
+                }
+                if (it != entries.end()) {
+                    if (waited) ++waits;
+                    else ++hits;
+                    return it->image;
+                }
+            }
+            ++misses;
+        }
+
+        QImage image = loader(r);
+
+        QMutexLocker lock(&mutex);
+        Entry e;
+        e.state = Ready;
+        e.image = image;
+        entries.insert(k, e);
+        return image;
+    }
+
+    // Non-blocking take(): false while the image is still queued or decoding.
+    // With `count`, a ready image is a prefetch hit and anything else a miss;
+    // pass false when collecting an image that was already counted as a miss.
+    bool takeIfReady(const PrefetchRequest& r, QImage *image, bool count = true) {
+        QMutexLocker lock(&mutex);
+        auto it = entries.find(key(r));
+        bool ready = it != entries.end() && it->state == Ready;
+        if (count) {
+            if (ready) ++hits;
+            else ++misses;
+        }
+        if (ready) *image = it->image;
+        return ready;
+    }
+
+    // Drops everything and waits for running decodes; call before the source
+    // the loader reads from (folder, bundle) changes.
+    void reset() {
+        {
+            QMutexLocker lock(&mutex);
+            for (auto it = entries.begin(); it != entries.end();)
+                it = cancel(it);
+        }
+        pool.waitForDone();
+
+        QMutexLocker lock(&mutex);
+        entries.clear();
+        deadline = -1;
+    }
+
+signals:
+    // Emitted from a worker thread once a requested image can be taken.
+    void imageReady(int index, const QSize& size);
+
+private:
+    enum State { Queued, Running, Ready };
+
+    class Job : public QRunnable {
+    public:
+        Job(PrefetchScheduler *s, quint64 k, const PrefetchRequest& r) : scheduler(s), k(k), r(r) {}
+        void run() override { scheduler->runJob(k, r); }
+
+    private:
+        PrefetchScheduler *scheduler;
+        quint64 k;
+        PrefetchRequest r;
+    };
+
+    struct Entry {
+        Entry() : state(Queued), cancelled(false), required(false), estimate(0), job(nullptr) {}
+        State state;
+        bool cancelled;
+        bool required;  // on screen now, not speculative
+        qint64 estimate; // bytes, counted against the budget until Ready
+        Job *job;       // only valid while Queued
+        QImage image;
+    };
+
+    QThreadPool pool;
+    mutable QMutex mutex;
+    QWaitCondition ready;
+    QHash<quint64, Entry> entries;
+    Loader loader;
+
+    int depth;
+    qint64 cacheBudget;
+    qint64 decodeMs;          // running average of one decode
+    qint64 navIntervalMs;     // running average between manual navigations
+    int navDirection;
+    qint64 deadline;          // on clock, -1 when no tick is scheduled
+    QElapsedTimer clock;
+    QElapsedTimer navClock;
+    int hits;
+    int waits;
+    int misses;
+
+    static qint64 estimateBytes(const QSize& size) {
+        return qint64(size.width()) * size.height() * 4;
+    }
+
+    static quint64 key(const PrefetchRequest& r) {
+        return (quint64(quint32(r.index)) << 32) | (quint64(r.size.width() & 0xffff) << 16) | quint64(r.size.height() & 0xffff);
+    }
+
+    bool userNavigating() const {
+        return navIntervalMs >= 0 && navIntervalMs < 1000 && navClock.elapsed() < 2 * navIntervalMs + 500;
+    }
+
+    // mutex held
+    QHash<quint64, Entry>::iterator cancel(QHash<quint64, Entry>::iterator it) {
+        if (it->state == Queued && pool.tryTake(it->job)) {
+            delete it->job;
+            return entries.erase(it);
+        }
+        if (it->state == Ready)
+            return entries.erase(it);
+
+        // Already picked up by a worker; runJob() drops the result.
+        it->cancelled = true;
+        return ++it;
+    }
+
+    // mutex held. One background thread is enough while there is slack before
+    // the next tick; go wide when the queue would not finish in time, or when
+    // something on screen right now is still waiting for its decode.
+    void throttle() {
+        int pending = 0;
+        bool onScreenPending = false;
+        for (const Entry& e : entries) {
+            if (e.state == Ready) continue;
+            ++pending;
+            if (e.required) onScreenPending = true;
+        }
+
+        qint64 remaining = deadline < 0 ? -1 : deadline - clock.elapsed();
+        bool urgent = onScreenPending || userNavigating() || (remaining >= 0 && pending * decodeMs * 2 > remaining);
+        pool.setMaxThreadCount(urgent ? qMax(1, QThread::idealThreadCount()) : 1);
+    }
+
+    void runJob(quint64 k, const PrefetchRequest& r) {
+        {
+            QMutexLocker lock(&mutex);
+            auto it = entries.find(k);
+            if (it == entries.end()) return;
+            if (it->cancelled) {
+                entries.erase(it);
+                ready.wakeAll();
+                return;
+            }
+            it->state = Running;
+            it->job = nullptr;
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        QImage image = loader(r);
+
+        bool delivered = false;
+        {
+            QMutexLocker lock(&mutex);
+            decodeMs = (decodeMs * 3 + timer.elapsed()) / 4;
+            auto it = entries.find(k);
+            if (it != entries.end()) {
+                if (it->cancelled) {
+                    entries.erase(it);
+                } else {
+                    it->image = image;
+                    it->state = Ready;
+                    delivered = true;
+                }
+            }
+            throttle();   // back to one thread once the on-screen work is done
+            ready.wakeAll();
+        }
+        if (delivered)
+            emit imageReady(r.index, r.size);
+    }
+};
+
+#endif // PREFETCH_H
@@ -0,0 +1,99 @@
+#ifndef PRESENTATION_H
+#define PRESENTATION_H
+
+#include <QAbstractAnimation>
+#include <QObject>
+#include <QPointer>
+#include <QTimer>
+#include <QVector>
+
+// Holds the fade-ins of a tick's panes until every pane has its pixmap (or a
+// deadline passes), then starts them together so a slow decode in one tile
+// does not stagger the whole grid.
+//
+// Animations started in the same event loop pass share one start time in
+// Qt's animation driver, so releasing them in one go is what keeps them in
+// step. The release happens on the next event loop pass; it is not aligned
+// to the display's refresh.
+class PresentationStage : public QObject {
+    Q_OBJECT
+
+public:
+    explicit PresentationStage(QObject *parent = nullptr)
+        : QObject(parent), expected(0), released(true), presented(0), missed(0) {
+        deadlineTimer.setSingleShot(true);
+        deadlineTimer.setTimerType(Qt::PreciseTimer);
+        connect(&deadlineTimer, &QTimer::timeout, this, &PresentationStage::deadlineMissed);
+
+        releaseTimer.setSingleShot(true);
+        connect(&releaseTimer, &QTimer::timeout, this, &PresentationStage::release);
+    }
+
+    // A new transition with this many panes; whatever was held is dropped.
+    void begin(int panes, int deadlineMs) {
+        cancel();
+        expected = panes;
+        released = false;
+        deadlineTimer.start(deadlineMs);
+    }
+
+    void cancel() {
+        deadlineTimer.stop();
+        releaseTimer.stop();
+        held.clear();
+        expected = 0;
+        released = true;
+    }
+
+    // The pane's pixmap is set; its fade starts together with the others.
+    // Panes that arrive after a missed deadline start straight away.
+    void stage(QAbstractAnimation *fade) {
+        if (released) {
+            fade->start();
+            return;
+        }
+        held.append(fade);
+        if (held.size() >= expected && !releaseTimer.isActive()) {
+            deadlineTimer.stop();
+            releaseTimer.start(0);
+        }
+    }
+
+    // True between begin() and the release of its fades.
+    bool isHolding() const { return !released; }
+
+    int listenerCount() const { return receivers(SIGNAL(transitionStarted())); }
+
+    int presentedCount() const { return presented; }
+    int missedCount() const { return missed; }
+
+signals:
+    void transitionStarted();
+
+private slots:
+    void deadlineMissed() {
+        ++missed;
+        releaseTimer.start(0);
+    }
+
+    void release() {
+        released = true;
+        ++presented;
+        for (const QPointer<QAbstractAnimation>& fade : held)
+            if (fade) fade->start();
+        held.clear();
+        emit transitionStarted();
+    }
+
+private:
+    QVector<QPointer<QAbstractAnimation>> held;
+    int expected;
+    bool released;
+    int presented;
+    int missed;
+
+    QTimer deadlineTimer;
+    QTimer releaseTimer;
+};
+
+#endif // PRESENTATION_H
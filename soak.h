@@ -0,0 +1,311 @@
+#ifndef SOAK_H
+#define SOAK_H
+
+#include <QCoreApplication>
+#include <QByteArray>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QImage>
+#include <QLinearGradient>
+#include <QObject>
+#include <QPainter>
+#include <QRandomGenerator>
+#include <QStringList>
+#include <QTextStream>
+#include <QTimer>
+#include <QVector>
+#include <functional>
+
+#include "timing.h"
+
+#ifdef Q_OS_LINUX
+#include <unistd.h>
+#endif
+
+// Long-running stress run for --soak.
+//
+// Fires weighted random actions at the viewer (ticks, next/prev, resizes,
+// mode switches) much faster than a real slideshow, and every sample period
+// prints one CSV row of resource counters and action latency percentiles.
+// At the end each counter is compared with its value after a 10% warm-up,
+// and the run fails if something kept growing or p95 latency regressed.
+class SoakRunner : public QObject {
+    Q_OBJECT
+
+public:
+    explicit SoakRunner(QObject *parent = nullptr)
+        : QObject(parent), duration(60 * 60 * 1000), rate(20), rng(1), actionsRun(0),
+          baselineTaken(false), baselineP95(0), lastP95(0) {
+        connect(&actionTimer, &QTimer::timeout, this, &SoakRunner::runAction);
+        connect(&sampleTimer, &QTimer::timeout, this, &SoakRunner::sample);
+
+        addProbe("rss_kb", 32 * 1024, &SoakRunner::residentKb);
+        addProbe("handles", 16, &SoakRunner::openHandles);
+    }
+
+    void setDuration(qint64 msecs) { duration = qMax<qint64>(1000, msecs); }
+    void setRate(int msecs) { rate = qMax(0, msecs); }
+    void setSeed(quint32 seed) { rng.seed(seed); }
+
+    void addAction(const QString& name, int weight, const std::function<void()>& run) {
+        actions.append({ name, qMax(1, weight), run });
+    }
+
+    // A count that must level off. Growth beyond max(slack, 10%) of the
+    // post-warm-up value fails the run; -1 means "not available here".
+    void addProbe(const QString& name, qint64 slack, const std::function<qint64()>& read) {
+        probes.append({ name, slack, read, -1, -1 });
+    }
+
+    void start() {
+        QStringList header;
+        header << "elapsed_s";
+        for (const Probe& p : probes) header << p.name;
+        header << "actions" << "p50_ms" << "p95_ms" << "p99_ms";
+        print(header.join(','));
+
+        clock.start();
+        window.start();
+        actionTimer.start(rate);
+        sampleTimer.start(int(qBound<qint64>(1000, duration / 100, 60000)));
+    }
+
+    // Writes `count` images of mixed size and format (JPEG, PNG with alpha,
+    // grayscale PNG, small animated GIF) into `folder`, 100 per subdirectory.
+    static bool writeSyntheticCorpus(const QString& folder, int count, quint32 seed) {
+        QRandomGenerator rng(seed);
+        for (int i = 0; i < count; ++i) {
+            QString subdir = QString("%1/d%2").arg(folder).arg(i / 100, 3, 10, QChar('0'));
+            if (!QDir().mkpath(subdir)) return false;
+
+            if (i % 10 == 7) {
+                QString name = QString("%1/img%2.gif").arg(subdir).arg(i, 6, 10, QChar('0'));
+                if (!writeGif(name, rng.bounded(64, 320), rng.bounded(48, 240), 4, rng.generate()))
+                    return false;
+                continue;
+            }
+
+            int w = rng.bounded(320, 2400);
+            int h = rng.bounded(240, 1800);
+            bool alpha = i % 3 == 0;
+            QImage image(w, h, alpha ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32);
+            image.fill(Qt::transparent);
+
+            QPainter painter(&image);
+            QLinearGradient gradient(0, 0, w, h);
+            gradient.setColorAt(0, QColor::fromRgb(rng.generate() | 0xff000000));
+            gradient.setColorAt(1, QColor::fromRgba(rng.generate() | (alpha ? 0x40000000 : 0xff000000)));
+            painter.fillRect(image.rect(), gradient);
+            for (int e = 0; e < 8; ++e) {
+                painter.setBrush(QColor::fromRgb(rng.generate() | 0xff000000));
+                painter.drawEllipse(rng.bounded(w), rng.bounded(h), rng.bounded(w / 2 + 1), rng.bounded(h / 2 + 1));
+            }
+            painter.end();
+
+            QString name = QString("%1/img%2").arg(subdir).arg(i, 6, 10, QChar('0'));
+            bool saved = alpha ? image.save(name + ".png")
+                       : i % 5 == 0 ? image.convertToFormat(QImage::Format_Grayscale8).save(name + ".png")
+                       : image.save(name + ".jpg", nullptr, 85);
+            if (!saved) return false;
+        }
+        return true;
+    }
+
+private:
+    struct Action {
+        QString name;
+        int weight;
+        std::function<void()> run;
+    };
+
+    struct Probe {
+        QString name;
+        qint64 slack;
+        std::function<qint64()> read;
+        qint64 baseline;
+        qint64 last;
+    };
+
+    QVector<Action> actions;
+    QVector<Probe> probes;
+    qint64 duration;
+    int rate;
+    QRandomGenerator rng;
+
+    QTimer actionTimer;
+    QTimer sampleTimer;
+    QElapsedTimer clock;
+    TimingReport window;   // action latencies since the last sample
+    qint64 actionsRun;
+    bool baselineTaken;
+    double baselineP95;
+    double lastP95;
+
+    void runAction() {
+        if (actions.isEmpty()) return;
+
+        int total = 0;
+        for (const Action& a : actions) total += a.weight;
+        int pick = rng.bounded(total);
+        const Action *action = &actions.first();
+        for (const Action& a : actions) {
+            if (pick < a.weight) {
+                action = &a;
+                break;
+            }
+            pick -= a.weight;
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        action->run();
+        window.add(timer.nsecsElapsed());
+        ++actionsRun;
+    }
+
+    void sample() {
+        qint64 now = clock.elapsed();
+
+        QStringList row;
+        row << QString::number(now / 1000.0, 'f', 1);
+        for (Probe& p : probes) {
+            p.last = p.read();
+            row << QString::number(p.last);
+        }
+        lastP95 = window.percentile(95);
+        row << QString::number(actionsRun)
+            << QString::number(window.percentile(50), 'f', 3)
+            << QString::number(lastP95, 'f', 3)
+            << QString::number(window.percentile(99), 'f', 3);
+        print(row.join(','));
+
+        if (!baselineTaken && now >= duration / 10) {
+            for (Probe& p : probes) p.baseline = p.last;
+            baselineP95 = lastP95;
+            baselineTaken = true;
+        }
+        window.start();
+
+        if (now >= duration) finish();
+    }
+
+    void finish() {
+        actionTimer.stop();
+        sampleTimer.stop();
+
+        QStringList failures;
+        for (const Probe& p : probes) {
+            if (p.baseline < 0 || p.last < 0) continue;
+            qint64 allowed = p.baseline + qMax(p.slack, p.baseline / 10);
+            if (p.last > allowed)
+                failures << QString("%1 grew from %2 to %3 (allowed %4)").arg(p.name).arg(p.baseline).arg(p.last).arg(allowed);
+        }
+        if (baselineP95 > 0 && lastP95 > baselineP95 * 2 + 5)
+            failures << QString("p95 latency regressed from %1 ms to %2 ms").arg(baselineP95, 0, 'f', 3).arg(lastP95, 0, 'f', 3);
+
+        print(QString("soak: %1 actions in %2 s").arg(actionsRun).arg(clock.elapsed() / 1000));
+        for (const QString& f : failures) print("soak: FAIL " + f);
+        print(failures.isEmpty() ? "soak: PASS" : "soak: FAIL");
+
+        QCoreApplication::exit(failures.isEmpty() ? 0 : 1);
+    }
+
+    // Qt reads GIFs but cannot write them, so this writes a looping animation
+    // by hand: a 6x6x6 colour cube palette and LZW data that only ever uses
+    // literal codes (a clear code every 250 pixels keeps the codes 9 bits wide).
+    static bool writeGif(const QString& path, int w, int h, int frames, quint32 seed) {
+        QRandomGenerator rng(seed);
+        QVector<QRgb> palette;
+        for (int c = 0; c < 256; ++c)
+            palette.append(c < 216 ? qRgb(c / 36 * 51, c / 6 % 6 * 51, c % 6 * 51) : qRgb(0, 0, 0));
+
+        QByteArray out("GIF89a");
+        auto put16 = [&out](int v) { out.append(char(v & 0xff)).append(char(v >> 8)); };
+        put16(w);
+        put16(h);
+        out.append(char(0xf7)).append(char(0)).append(char(0));   // 256-entry global palette
+        for (QRgb c : palette)
+            out.append(char(qRed(c))).append(char(qGreen(c))).append(char(qBlue(c)));
+        out.append("\x21\xff\x0bNETSCAPE2.0\x03\x01\x00\x00\x00", 19);   // loop forever
+
+        QColor background = QColor::fromRgb(rng.generate() | 0xff000000);
+        QColor ball = QColor::fromRgb(rng.generate() | 0xff000000);
+        for (int f = 0; f < frames; ++f) {
+            QImage image(w, h, QImage::Format_RGB32);
+            image.fill(background);
+            QPainter painter(&image);
+            painter.setBrush(ball);
+            painter.drawEllipse(f * w / frames, h / 4, w / 3, h / 2);
+            painter.end();
+            image = image.convertToFormat(QImage::Format_Indexed8, palette, Qt::ThresholdDither);
+
+            out.append("\x21\xf9\x04\x00", 4);    // graphic control: 100 ms per frame
+            put16(10);
+            out.append(char(0)).append(char(0));
+            out.append(char(0x2c));
+            put16(0);
+            put16(0);
+            put16(w);
+            put16(h);
+            out.append(char(0)).append(char(8));   // no local palette; LZW minimum code size
+
+            QByteArray codes;
+            quint32 bits = 0;
+            int bitCount = 0;
+            auto emitCode = [&](int code) {
+                bits |= quint32(code) << bitCount;
+                for (bitCount += 9; bitCount >= 8; bitCount -= 8, bits >>= 8)
+                    codes.append(char(bits & 0xff));
+            };
+            int run = 0;
+            for (int y = 0; y < h; ++y) {
+                const uchar *line = image.constScanLine(y);
+                for (int x = 0; x < w; ++x) {
+                    if (run++ % 250 == 0) emitCode(256);
+                    emitCode(line[x]);
+                }
+            }
+            emitCode(257);
+            if (bitCount > 0) codes.append(char(bits & 0xff));
+
+            for (int p = 0; p < codes.size(); p += 255) {
+                int n = qMin(255, int(codes.size()) - p);
+                out.append(char(n)).append(codes.constData() + p, n);
+            }
+            out.append(char(0));
+        }
+        out.append(char(0x3b));
+
+        QFile file(path);
+        return file.open(QIODevice::WriteOnly) && file.write(out) == out.size();
+    }
+
+    static void print(const QString& line) {
+        QTextStream out(stdout);
+        out << line << "\n";
+        out.flush();
+    }
+
+    static qint64 residentKb() {
+#ifdef Q_OS_LINUX
+        QFile statm("/proc/self/statm");
+        if (!statm.open(QIODevice::ReadOnly)) return -1;
+        QList<QByteArray> fields = statm.readAll().split(' ');
+        if (fields.size() < 2) return -1;
+        return fields[1].toLongLong() * sysconf(_SC_PAGESIZE) / 1024;
+#else
+        return -1;
+#endif
+    }
+
+    static qint64 openHandles() {
+#ifdef Q_OS_LINUX
+        return QDir("/proc/self/fd").entryList(QDir::AllEntries | QDir::System | QDir::NoDotAndDotDot).size();
+#else
+        return -1;
+#endif
+    }
+};
+
+#endif // SOAK_H
@@ -0,0 +1,56 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <QElapsedTimer>
+#include <QString>
+#include <QVector>
+#include <algorithm>
+
+// Collects per-tick latencies for the --ticks timing report.
+class TimingReport {
+public:
+    void start() {
+        samples.clear();
+        wall.start();
+    }
+
+    void add(qint64 nsecs) { samples.append(nsecs); }
+    int count() const { return samples.size(); }
+    qint64 wallMs() const { return wall.isValid() ? wall.elapsed() : 0; }
+
+    // Nearest-rank percentile in milliseconds, p in [0, 100].
+    double percentile(double p) const {
+        if (samples.isEmpty()) return 0.0;
+        QVector<qint64> sorted = samples;
+        std::sort(sorted.begin(), sorted.end());
+        int rank = qBound(0, int(p / 100.0 * sorted.size() + 0.5) - 1, int(sorted.size()) - 1);
+        return sorted[rank] / 1e6;
+    }
+
+    double mean() const {
+        if (samples.isEmpty()) return 0.0;
+        double sum = 0;
+        for (qint64 s : samples) sum += s;
+        return sum / samples.size() / 1e6;
+    }
+
+    // One "name: value" per line so runs can be diffed build against build.
+    QString summary() const {
+        QString out;
+        out += QString("ticks: %1\n").arg(count());
+        out += QString("wall_ms: %1\n").arg(wallMs());
+        out += QString("tick_mean_ms: %1\n").arg(mean(), 0, 'f', 3);
+        out += QString("tick_min_ms: %1\n").arg(percentile(0), 0, 'f', 3);
+        out += QString("tick_p50_ms: %1\n").arg(percentile(50), 0, 'f', 3);
+        out += QString("tick_p90_ms: %1\n").arg(percentile(90), 0, 'f', 3);
+        out += QString("tick_p99_ms: %1\n").arg(percentile(99), 0, 'f', 3);
+        out += QString("tick_max_ms: %1\n").arg(percentile(100), 0, 'f', 3);
+        return out;
+    }
+
+private:
+    QVector<qint64> samples;
+    QElapsedTimer wall;
+};
+
+#endif // TIMING_H
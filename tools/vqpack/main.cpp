@@ -0,0 +1,128 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QImage>
+#include <QImageReader>
+#include <QDebug>
+#include <QVector>
+
+#include "bundle.h"
+#include "imageformat.h"
+
+// Packs a folder of images into a single .vqb slideshow bundle that ViewQ
+// can open like a folder. Images are scaled down to the display size once,
+// here, so the viewer only has to mmap the file at startup.
+
+static bool padTo(QFile& out, quint32 alignment) {
+    const qint64 pad = (alignment - out.pos() % alignment) % alignment;
+    return out.write(QByteArray(int(pad), '\0')) == pad;
+}
+
+static QImage prepare(const QImage& source, const QSize& displaySize) {
+    QImage image = normalizeImage(source);
+    if (image.width() > displaySize.width() || image.height() > displaySize.height())
+        image = image.scaled(displaySize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    return image;   // smooth scaling keeps the native format, as in the viewer's decodeScaled()
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("vqpack");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Pack a folder of images into a ViewQ slideshow bundle.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("folder", "Folder to pack (searched recursively).");
+    parser.addPositionalArgument("output", "Bundle file to write (*.vqb).");
+    QCommandLineOption sizeOption(QStringList() << "s" << "size", "Display resolution to scale for.", "WxH", "1920x1080");
+    parser.addOption(sizeOption);
+    parser.process(app);
+
+    const QStringList args = parser.positionalArguments();
+    if (args.size() != 2) parser.showHelp(1);
+
+    const QStringList size = parser.value(sizeOption).split('x');
+    QSize displaySize = size.size() == 2 ? QSize(size[0].toInt(), size[1].toInt()) : QSize();
+    if (displaySize.isEmpty()) {
+        qWarning() << "Invalid --size:" << parser.value(sizeOption);
+        return 1;
+    }
+
+    // Same file set as ImageViewer::loadImagesFromFolder(), in a stable order.
+    QString folderPath = args[0];
+    QDir dir(folderPath);
+    QStringList filters = { "*.jpg", "*.jpeg", "*.png", "*.bmp", "*.gif" };
+    QStringList images;
+    QDirIterator it(folderPath, filters, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext())
+        images << dir.relativeFilePath(it.next());
+    images.sort();
+
+    QFile out(args[1]);
+    if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Cannot write" << out.fileName() << ":" << out.errorString();
+        return 1;
+    }
+
+    BundleHeader header = {};
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    QVector<BundleEntry> entries;
+    QByteArray names;
+    for (const QString& name : images) {
+        QImageReader reader(dir.filePath(name));
+        QImage source = reader.read();   // first frame only for GIFs
+        if (source.isNull()) {
+            qWarning() << "Skipping" << name << ":" << reader.errorString();
+            continue;
+        }
+        QImage image = prepare(source, displaySize);
+
+        padTo(out, BundleAlignment);
+        const QByteArray utf8 = name.toUtf8();
+
+        BundleEntry e;
+        e.dataOffset = qToLittleEndian(quint64(out.pos()));
+        e.width = qToLittleEndian(quint32(image.width()));
+        e.height = qToLittleEndian(quint32(image.height()));
+        e.bytesPerLine = qToLittleEndian(quint32(image.bytesPerLine()));
+        e.format = qToLittleEndian(quint32(image.format()));
+        e.nameOffset = qToLittleEndian(quint32(names.size()));
+        e.nameLength = qToLittleEndian(quint32(utf8.size()));
+        e.sourceWidth = qToLittleEndian(quint32(source.width()));
+        e.sourceHeight = qToLittleEndian(quint32(source.height()));
+
+        const qint64 bytes = qint64(image.bytesPerLine()) * image.height();
+        if (out.write(reinterpret_cast<const char*>(image.constBits()), bytes) != bytes) {
+            qWarning() << "Write failed:" << out.errorString();
+            return 1;
+        }
+        entries.append(e);
+        names.append(utf8);
+    }
+
+    padTo(out, BundleAlignment);
+    const quint64 indexOffset = quint64(out.pos());
+    out.write(reinterpret_cast<const char*>(entries.constData()), entries.size() * qint64(sizeof(BundleEntry)));
+    out.write(names);
+
+    memcpy(header.magic, BundleMagic, sizeof(BundleMagic));
+    header.version = qToLittleEndian(BundleVersion);
+    header.entryCount = qToLittleEndian(quint32(entries.size()));
+    header.displayWidth = qToLittleEndian(quint32(displaySize.width()));
+    header.displayHeight = qToLittleEndian(quint32(displaySize.height()));
+    header.indexOffset = qToLittleEndian(indexOffset);
+    out.seek(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    if (out.error() != QFileDevice::NoError) {
+        qWarning() << "Write failed:" << out.errorString();
+        return 1;
+    }
+    out.close();
+
+    qInfo() << "Packed" << entries.size() << "of" << images.size() << "images into" << out.fileName();
+    return 0;
+}